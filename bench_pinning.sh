@@ -0,0 +1,91 @@
+#!/bin/sh
+#
+# SYSC4001 – Assignment 3 – Part 2(b)
+# Student: 101231344
+#
+# Compare placements of part2b_101231344. Every mode runs the same
+# coordinator setup (--shards N), so the only differences are CPU
+# pinning (--pin) and NUMA placement (--numa). Simulated delays are
+# disabled (--sleep-scale 0) and the list is marked many times over
+# (--passes), so the run is dominated by semaphore hand-offs and
+# cross-CPU cache traffic on the shared segments. Each run is timed by
+# the coordinator's own "elapsed" figure, which excludes process start-up.
+#
+# Usage:
+#   ./bench_pinning.sh [num_TAs] [reps] [shards] [passes]
+#
+#   [shards] defaults to the number of NUMA nodes with CPUs.
+#   [passes] defaults to 40 (about 10k exams per run).
+#
+# Results are printed and also written to bench_output.txt.
+
+set -e
+
+TAS=${1:-4}
+REPS=${2:-5}
+
+# Count only nodes with CPUs, as discover_numa_nodes() does.
+NODES=0
+for f in /sys/devices/system/node/node[0-9]*/cpulist; do
+    [ -s "$f" ] && [ -n "$(tr -d ' \n' < "$f")" ] && NODES=$((NODES + 1))
+done
+[ "$NODES" -ge 1 ] || NODES=1
+SHARDS=${3:-$NODES}
+PASSES=${4:-40}
+NUM_EXAMS=255            # plus the 9999 terminator = MAX_EXAMS
+
+cd "$(dirname "$0")"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+gcc -O2 -Wall -Wextra -std=c11 -pthread -o "$WORK/part2b" part2b_101231344.c
+
+mkdir "$WORK/exams"
+i=1
+while [ "$i" -le "$NUM_EXAMS" ]; do
+    f=$(printf '%s/exams/exam_%04d.txt' "$WORK" "$i")
+    printf '%04d\n' "$i" > "$f"
+    echo "$f" >> "$WORK/exam_list.txt"
+    i=$((i + 1))
+done
+echo 9999 > "$WORK/exams/exam_9999.txt"
+echo "$WORK/exams/exam_9999.txt" >> "$WORK/exam_list.txt"
+
+# run_mode <label> <extra options...>
+run_mode() {
+    label=$1
+    shift
+    times=""
+    r=0
+    while [ "$r" -lt "$REPS" ]; do
+        t=$("$WORK/part2b" "$TAS" rubric.txt "$WORK/exam_list.txt" \
+                --shards "$SHARDS" --passes "$PASSES" --sleep-scale 0 "$@" |
+            awk '$1 == "[COORD]" && $2 == "total" { sub(/s$/, "", $6); print $6 }')
+        if [ -z "$t" ]; then
+            echo "$label: run failed (no [COORD] total line)" >&2
+            exit 1
+        fi
+        times="$times $t"
+        r=$((r + 1))
+    done
+    echo "$times" | awk -v label="$label" '{
+        min = $1; sum = 0;
+        for (i = 1; i <= NF; ++i) { sum += $i; if ($i < min) min = $i; }
+        printf "%-10s min %9.2f ms   avg %9.2f ms   (%d runs)\n",
+               label, min * 1000, sum / NF * 1000, NF;
+    }'
+}
+
+{
+    echo "part2b_101231344: $SHARDS shards x $TAS TAs," \
+         "$((NUM_EXAMS + 1)) exams x $PASSES passes," \
+         "$(nproc) CPUs, $NODES NUMA node(s) with CPUs"
+    if [ "$NODES" -le 1 ]; then
+        echo "note: only one NUMA node found; --numa rows differ from the" \
+             "others only by CPU affinity"
+    fi
+    run_mode unpinned
+    run_mode pinned   --pin
+    run_mode numa     --numa
+    run_mode numa+pin --numa --pin
+} | tee bench_output.txt
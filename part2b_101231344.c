@@ -5,7 +5,34 @@
  * Concurrent TAs marking exams – semaphore + shared memory version.
  *
  * Usage:
- *   ./part2b_101231344 <num_TAs> <rubric_file> <exam_list_file>
+ *   ./part2b_101231344 <num_TAs> <rubric_file> <exam_list_file> [options]
+ *
+ * Options:
+ *   --seed <n>       : base seed for the per-TA random number generators
+ *   --record <file>  : log every lock-protected step (finished checks,
+ *                      question claims, exam loads, rubric corrections)
+ *                      in order to a binary trace file
+ *   --replay <file>  : re-run a recorded trace, forcing the TAs through
+ *                      the same interleaving (same seed, same order)
+ *   --timeline <file>: write per-TA activity spans as Chrome trace-event
+ *                      JSON (loadable in Perfetto / about:tracing)
+ *   --stats <name>   : publish live progress in the named shared-memory
+ *                      segment <name> (layout in ta_stats_101231344.h),
+ *                      for the read-only tamon monitor
+ *   --shards <k>     : coordinator mode – split the exam list across k
+ *                      independent TA groups (num_TAs each), each with
+ *                      its own shared segment and semaphores
+ *   --pin            : pin each TA to its own CPU, by global TA id (by
+ *                      position among the TAs on its node with --numa),
+ *                      wrapping only when TAs outnumber CPUs
+ *   --numa           : place each shard on a NUMA node: its TAs run on
+ *                      that node's CPUs and its segment is bound to the
+ *                      node's memory. Implies --shards <num_nodes>
+ *                      unless --shards is given
+ *   --sleep-scale <f>: multiply every simulated delay by f (0 = none),
+ *                      e.g. to benchmark synchronisation overhead
+ *   --passes <n>     : mark the exam list (up to the 9999 terminator)
+ *                      n times over, to make benchmark runs longer
  *
  * This program converts Part 2(a) into a semaphore-based solution with
  * shared memory. The critical sections are protected by semaphores so
@@ -17,21 +44,115 @@
  * 
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <string.h>
 #include <time.h>
 #include <semaphore.h>
+#include <sched.h>
+#include <errno.h>
+
+#include "ta_stats_101231344.h"
 
 #define NUM_QUESTIONS   5
 #define MAX_EXAMS       256
 #define MAX_PATH_LEN    256
 #define RUBRIC_LINE_LEN 32
+#define MAX_TAS         64
+#define MAX_SHARDS      64
+#define MAX_EXAM_INDEX  65535  /* exam indices are 16 bits in traces/timelines */
+#define MAX_NUMA_NODES  64
+#define TA_MPOL_PREFERRED 1    /* MPOL_PREFERRED from <numaif.h> */
+
+_Static_assert(MAX_TAS <= TA_STATS_MAX_TAS, "stats segment too small for MAX_TAS");
+
+#define MAX_TRACE_EVENTS (1 << 17)
+#define TRACE_MAGIC      0x52544154u   /* "TATR" */
+#define TRACE_VERSION    1
+#define TRACE_NO_QUESTION 0xff
+
+enum { TRACE_OFF = 0, TRACE_RECORD, TRACE_REPLAY };
+
+/* One trace event per acquisition of mutex_exam / mutex_rubric by a TA.
+ * Each TA draws from its own seeded generator, so replaying the same
+ * acquisition order reproduces the whole run.                         */
+enum {
+    EV_CHECK   = 1,   /* finished check at the top of ta_main (value = finished) */
+    EV_CLAIM   = 2,   /* question claim (question = q or TRACE_NO_QUESTION)      */
+    EV_ADVANCE = 3,   /* load-next-exam step (exam_index after, value = finished) */
+    EV_RUBRIC  = 4    /* rubric correction (question = q, value = new letter)    */
+};
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  ta_id;
+    uint8_t  question;
+    uint8_t  value;
+    uint16_t exam_index;
+    uint16_t reserved;
+} trace_event_t;
+
+/* Trace file: header followed by num_events trace_event_t records. */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_tas;
+    uint64_t seed;
+    uint32_t num_events;
+    uint32_t reserved;
+} trace_header_t;
+
+/* Coordinator <-> shard protocol over a Unix domain socketpair.
+ *   shard -> coord : SHARD_MSG_REQUEST          (needs more exams)
+ *   coord -> shard : SHARD_MSG_RANGE [begin,end) (begin == end: none left)
+ *   shard -> coord : SHARD_MSG_DONE + counters  (group has finished)   */
+enum { SHARD_MSG_REQUEST = 1, SHARD_MSG_RANGE, SHARD_MSG_DONE };
+
+typedef struct {
+    int32_t type;
+    int32_t begin;
+    int32_t end;
+    int32_t exams_completed;
+    int32_t questions_marked;
+    int32_t rubric_corrections;
+    int64_t elapsed_ns;
+} shard_msg_t;
+
+#define MAX_SPANS_PER_TA 8192
+
+enum { SPAN_REVIEW = 0, SPAN_WAIT, SPAN_MARK, SPAN_LOAD };
+enum { SEM_RUBRIC = 0, SEM_EXAM, SEM_PRINT };
+
+/* One timeline span; arg is the semaphore (SPAN_WAIT) or question (SPAN_MARK). */
+typedef struct {
+    uint64_t start_us;
+    uint32_t dur_us;
+    uint8_t  kind;
+    uint8_t  arg;
+    uint16_t exam_index;
+} span_t;
+
+/* Per-TA span buffer; only ever written by its owner, read by the parent
+ * after every TA has exited, so no locking is needed.                   */
+typedef struct {
+    unsigned int count;
+    unsigned int dropped;
+    span_t       spans[MAX_SPANS_PER_TA];
+} ta_timeline_t;
 
 typedef struct {
     char rubric[NUM_QUESTIONS][RUBRIC_LINE_LEN];
@@ -40,26 +161,194 @@ typedef struct {
     char exam_filenames[MAX_EXAMS][MAX_PATH_LEN];
     int  exam_student_ids[MAX_EXAMS];
 
+    /* Exams up to and including the 9999 terminator form one pass; with
+     * --passes the run walks that pass repeatedly, so exam indices run
+     * up to pass_len * passes and map back to the list via exam_slot(). */
+    int  pass_len;
+    int  passes;
+
     int  current_exam_index;
     int  current_student_id;
 
     int  question_marked[NUM_QUESTIONS];
 
+    /* Exclusive end of the exam range this group may load from; the
+     * whole list normally, a coordinator-assigned range in --shards. */
+    int  range_end;
+
     int  finished;
 
+    /* Group totals reported to the coordinator (under the matching mutex). */
+    int  exams_completed;      /* mutex_exam   */
+    int  questions_marked;     /* mutex_exam   */
+    int  rubric_corrections;   /* mutex_rubric */
+
     /* Semaphores in shared memory. */
     sem_t mutex_rubric;   /* protects rubric modifications */
     sem_t mutex_exam;     /* protects questions + exam loading */
     sem_t mutex_print;    /* serialises printing    */
 
+    /* Record/replay of the lock acquisition order (see seq_enter()). */
+    int           num_tas;
+    int           trace_mode;
+    int           replay_active;
+    int           trace_overflow;
+    unsigned int  trace_pos;
+    unsigned int  trace_count;
+    sem_t         mutex_trace;               /* protects the fields above */
+
 } shared_data_t;
 
+/* Record/replay buffers, in their own segment created only for --record
+ * or --replay. Events are protected by shared_data_t::mutex_trace.     */
+typedef struct {
+    sem_t         ta_turn[MAX_TAS + 1];      /* replay: wakes TA i for its turn */
+    trace_event_t events[MAX_TRACE_EVENTS];
+} trace_buf_t;
+
 static int shm_id = -1;
+static int trace_shm_id = -1;
+static trace_buf_t *trace_buf = NULL;
+
+/* Socket to the coordinator in --shards mode, inherited by the TAs. */
+static int shard_fd = -1;
+
+/* Placement: the CPUs this TA group may run on, whether each TA gets a
+ * CPU of its own (--pin), and the NUMA nodes found at start-up.       */
+typedef struct {
+    int       id;        /* kernel node id, -1 if unknown (no sysfs) */
+    cpu_set_t cpus;
+} numa_node_t;
+
+static cpu_set_t   group_cpus;
+static int         pin_tas = 0;
+static int         use_numa = 0;
+static numa_node_t numa_nodes[MAX_NUMA_NODES];
+static int         num_numa_nodes = 0;
+
+static double sleep_scale = 1.0;
+
+static int timeline_shm_id = -1;
+
+/* Timeline state: the parent sets these before forking, then each TA
+ * points my_timeline at its own slot. NULL when --timeline is off.   */
+static ta_timeline_t *timelines = NULL;
+static ta_timeline_t *my_timeline = NULL;
+static uint64_t timeline_t0_us;
+
+/* Live stats: mapped before forking, so every TA inherits the mapping.
+ * my_stats is the calling TA's row (NULL in the parent / when off).   */
+static ta_stats_t    *stats = NULL;
+static ta_stats_ta_t *my_stats = NULL;
+static int            my_state = TA_STATE_IDLE;
+static char           stats_name[MAX_PATH_LEN];
+static dev_t          stats_dev;     /* identity of the segment we created, */
+static ino_t          stats_ino;     /* so exit never unlinks someone else's */
+
+/* Per-process generator state: every TA is its own process, so each one
+ * gets an independent xorshift64* stream derived from the base seed.   */
+static uint64_t rng_state = 1;
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void rng_seed(uint64_t seed, int ta_id) {
+    uint64_t x = seed ^ ((uint64_t)ta_id << 32);
+    rng_state = splitmix64(&x);
+    if (rng_state == 0) rng_state = 1;
+}
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_us(void) {
+    return now_ns() / 1000u;
+}
+
+/* Publish what this TA is doing. Relaxed stores only: readers tolerate
+ * slightly stale values and the TAs never wait on the monitor.        */
+static void stats_set_state(int state, int exam_index, int question) {
+    my_state = state;
+    if (!my_stats) return;
+
+    __atomic_store_n(&my_stats->exam_index, exam_index, __ATOMIC_RELAXED);
+    __atomic_store_n(&my_stats->question, question, __ATOMIC_RELAXED);
+    __atomic_store_n(&my_stats->state, (uint32_t)state, __ATOMIC_RELAXED);
+}
+
+/* sem_wait that counts acquisitions, contended acquisitions and time
+ * spent blocked per semaphore in the live stats segment.              */
+static void acquire(sem_t *sem, int sem_id) {
+    if (!stats) {
+        sem_wait(sem);
+        return;
+    }
+
+    ta_lock_stats_t *ls = &stats->locks[sem_id];
+    __atomic_fetch_add(&ls->acquisitions, 1, __ATOMIC_RELAXED);
+
+    if (sem_trywait(sem) == 0) return;
+
+    if (my_stats) {
+        __atomic_store_n(&my_stats->waiting_on, (uint32_t)sem_id, __ATOMIC_RELAXED);
+        __atomic_store_n(&my_stats->state, TA_STATE_WAITING, __ATOMIC_RELAXED);
+    }
+
+    uint64_t t = now_ns();
+    sem_wait(sem);
+    __atomic_fetch_add(&ls->contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ls->wait_ns, now_ns() - t, __ATOMIC_RELAXED);
+
+    if (my_stats) {
+        __atomic_store_n(&my_stats->state, (uint32_t)my_state, __ATOMIC_RELAXED);
+    }
+}
+
+static uint64_t span_begin(void) {
+    return my_timeline ? now_us() : 0;
+}
+
+static void span_end(uint64_t start, int kind, int arg, int exam_index) {
+    if (!my_timeline) return;
+
+    if (my_timeline->count >= MAX_SPANS_PER_TA) {
+        my_timeline->dropped++;
+        return;
+    }
+
+    span_t *sp = &my_timeline->spans[my_timeline->count++];
+    sp->start_us   = start - timeline_t0_us;
+    sp->dur_us     = (uint32_t)(now_us() - start);
+    sp->kind       = (uint8_t)kind;
+    sp->arg        = (uint8_t)arg;
+    sp->exam_index = (uint16_t)exam_index;
+}
+
+/* sem_wait that records the time spent blocked on the timeline. */
+static void lock_wait(sem_t *sem, int sem_id) {
+    uint64_t t = span_begin();
+    acquire(sem, sem_id);
+    span_end(t, SPAN_WAIT, sem_id, 0);
+}
 
 static void random_sleep(double min_sec, double max_sec) {
-    double r = (double)rand() / (double)RAND_MAX;
-    double s = min_sec + r * (max_sec - min_sec);
-    if (s < 0.0) s = 0.0;
+    double r = (double)(rng_next() >> 11) / 9007199254740992.0;
+    double s = (min_sec + r * (max_sec - min_sec)) * sleep_scale;
+    if (s <= 0.0) return;
     usleep((useconds_t)(s * 1e6));
 }
 
@@ -140,33 +429,144 @@ static void load_exam_list(const char *list_file, shared_data_t *shared) {
     }
 
     shared->total_exams = count;
+
+    /* The 9999 terminator ends the run, so exams listed after it are
+     * never reached.                                                 */
+    shared->pass_len = count;
+    for (int i = 0; i < count; ++i) {
+        if (shared->exam_student_ids[i] == 9999) {
+            shared->pass_len = i + 1;
+            break;
+        }
+    }
+    shared->passes = 1;
+}
+
+/* One past the last exam index that will be marked. */
+
+static int exam_end_index(const shared_data_t *shared) {
+    return shared->pass_len * shared->passes;
+}
+
+/* --passes: walk the list n times; indices must stay within 16 bits. */
+
+static void set_passes(shared_data_t *shared, int passes) {
+    if (passes < 1 || (long)shared->pass_len * passes > MAX_EXAM_INDEX) {
+        fprintf(stderr, "Error: --passes must be between 1 and %d for this "
+                        "exam list\n", MAX_EXAM_INDEX / shared->pass_len);
+        exit(EXIT_FAILURE);
+    }
+    shared->passes = passes;
+}
+
+/* Position in the exam list of (possibly repeated) exam index idx. */
+
+static int exam_slot(const shared_data_t *shared, int idx) {
+    return idx % shared->pass_len;
 }
 
 /* Must be called with mutex_exam HELD. */
 
 static void load_exam(shared_data_t *shared, int idx) {
-    if (idx < 0 || idx >= shared->total_exams) {
+    if (idx < 0 || idx >= exam_end_index(shared)) {
         shared->finished = 1;
         return;
     }
 
     shared->current_exam_index = idx;
-    shared->current_student_id = shared->exam_student_ids[idx];
+    shared->current_student_id = shared->exam_student_ids[exam_slot(shared, idx)];
 
     for (int i = 0; i < NUM_QUESTIONS; ++i) {
         shared->question_marked[i] = 0;
     }
 
-    sem_wait(&shared->mutex_print);
+    if (stats) {
+        __atomic_store_n(&stats->current_exam_index, idx, __ATOMIC_RELAXED);
+        __atomic_store_n(&stats->current_student_id,
+                         shared->current_student_id, __ATOMIC_RELAXED);
+        __atomic_store_n(&stats->questions_remaining, NUM_QUESTIONS,
+                         __ATOMIC_RELAXED);
+    }
+
+    lock_wait(&shared->mutex_print, SEM_PRINT);
     printf("[PARENT/TA] Loaded exam %s (student %04d) into shared memory\n",
-           shared->exam_filenames[idx],
+           shared->exam_filenames[exam_slot(shared, idx)],
            shared->current_student_id);
     fflush(stdout);
     sem_post(&shared->mutex_print);
 }
 
-static void review_rubric(shared_data_t *shared, int ta_id) {
-    sem_wait(&shared->mutex_print);
+/* Replay ran out of events or diverged: release every waiting TA and
+ * fall back to ordinary locking. Must be called with mutex_trace HELD. */
+
+static void stop_replay_nolock(shared_data_t *shared) {
+    shared->replay_active = 0;
+    for (int i = 1; i <= shared->num_tas; ++i) {
+        sem_post(&trace_buf->ta_turn[i]);
+    }
+}
+
+/* Acquire a traced lock. In replay mode the TA first waits until the
+ * next event in the trace belongs to it.                              */
+
+static void seq_enter(shared_data_t *shared, int ta_id, sem_t *lock,
+                      int sem_id) {
+    uint64_t t = span_begin();
+
+    while (shared->trace_mode == TRACE_REPLAY) {
+        sem_wait(&shared->mutex_trace);
+        int my_turn = !shared->replay_active ||
+                      trace_buf->events[shared->trace_pos].ta_id == ta_id;
+        sem_post(&shared->mutex_trace);
+
+        if (my_turn) break;
+        sem_wait(&trace_buf->ta_turn[ta_id]);
+    }
+
+    acquire(lock, sem_id);
+    span_end(t, SPAN_WAIT, sem_id, 0);
+}
+
+/* Release a traced lock, recording ev (record mode) or checking it
+ * against the trace and handing the turn to the next TA (replay mode). */
+
+static void seq_leave(shared_data_t *shared, sem_t *lock,
+                      const trace_event_t *ev) {
+    if (shared->trace_mode != TRACE_OFF) {
+        sem_wait(&shared->mutex_trace);
+
+        if (shared->trace_mode == TRACE_RECORD) {
+            if (shared->trace_count < MAX_TRACE_EVENTS) {
+                trace_buf->events[shared->trace_count++] = *ev;
+            } else {
+                shared->trace_overflow = 1;
+            }
+        } else if (shared->replay_active) {
+            const trace_event_t *want = &trace_buf->events[shared->trace_pos];
+            if (memcmp(want, ev, sizeof(*ev)) != 0) {
+                fprintf(stderr,
+                        "Replay diverged at event %u (TA %d type %d); "
+                        "continuing unsequenced\n",
+                        shared->trace_pos, ev->ta_id, ev->type);
+                stop_replay_nolock(shared);
+            } else if (++shared->trace_pos >= shared->trace_count) {
+                stop_replay_nolock(shared);
+            } else {
+                int next_ta = trace_buf->events[shared->trace_pos].ta_id;
+                sem_post(&trace_buf->ta_turn[next_ta]);
+            }
+        }
+
+        sem_post(&shared->mutex_trace);
+    }
+
+    sem_post(lock);
+}
+
+static void review_rubric(shared_data_t *shared, int ta_id, int idx) {
+    stats_set_state(TA_STATE_REVIEWING, idx, -1);
+
+    lock_wait(&shared->mutex_print, SEM_PRINT);
     printf("[TA %d] Reviewing rubric for exam %04d\n",
            ta_id, shared->current_student_id);
     fflush(stdout);
@@ -175,9 +575,12 @@ static void review_rubric(shared_data_t *shared, int ta_id) {
     for (int q = 0; q < NUM_QUESTIONS; ++q) {
         random_sleep(0.5, 1.0);
 
-        int change = rand() % 2;
+        int change = (int)(rng_next() >> 63);
         if (change) {
-            sem_wait(&shared->mutex_rubric);
+            trace_event_t ev = { .type = EV_RUBRIC, .ta_id = (uint8_t)ta_id,
+                                 .question = (uint8_t)q };
+
+            seq_enter(shared, ta_id, &shared->mutex_rubric, SEM_RUBRIC);
 
             char *line = shared->rubric[q];
             char *comma = strchr(line, ',');
@@ -188,8 +591,14 @@ static void review_rubric(shared_data_t *shared, int ta_id) {
                     char old = *p;
                     char newc = (old < 'Z') ? (old + 1) : old;
                     *p = newc;
-
-                    sem_wait(&shared->mutex_print);
+                    ev.value = (uint8_t)newc;
+                    shared->rubric_corrections++;
+                    if (my_stats) {
+                        __atomic_fetch_add(&my_stats->rubric_corrections, 1,
+                                           __ATOMIC_RELAXED);
+                    }
+
+                    lock_wait(&shared->mutex_print, SEM_PRINT);
                     printf("[TA %d] Corrected rubric Q%d: %c -> %c\n",
                            ta_id, q + 1, old, newc);
                     fflush(stdout);
@@ -197,7 +606,7 @@ static void review_rubric(shared_data_t *shared, int ta_id) {
                 }
             }
 
-            sem_post(&shared->mutex_rubric);
+            seq_leave(shared, &shared->mutex_rubric, &ev);
         }
     }
 }
@@ -208,33 +617,48 @@ static void review_rubric(shared_data_t *shared, int ta_id) {
 static int mark_one_question(shared_data_t *shared, int ta_id) {
     int q_to_mark = -1;
     int student;
+    trace_event_t ev = { .type = EV_CLAIM, .ta_id = (uint8_t)ta_id,
+                         .question = TRACE_NO_QUESTION };
 
-    sem_wait(&shared->mutex_exam);
-
-    if (shared->finished) {
-        sem_post(&shared->mutex_exam);
-        return 0;
-    }
+    seq_enter(shared, ta_id, &shared->mutex_exam, SEM_EXAM);
 
     student = shared->current_student_id;
+    ev.exam_index = (uint16_t)shared->current_exam_index;
+
+    if (!shared->finished) {
+        for (int q = 0; q < NUM_QUESTIONS; ++q) {
+            if (shared->question_marked[q] == 0) {
+                q_to_mark = q;
+                shared->question_marked[q] = 1;  /* reserve this question */
+                ev.question = (uint8_t)q;
+                shared->questions_marked++;
+                break;
+            }
+        }
 
-    for (int q = 0; q < NUM_QUESTIONS; ++q) {
-        if (shared->question_marked[q] == 0) {
-            q_to_mark = q;
-            shared->question_marked[q] = 1;  /* reserve this question */
-            break;
+        if (stats && q_to_mark != -1) {
+            __atomic_fetch_sub(&stats->questions_remaining, 1, __ATOMIC_RELAXED);
         }
     }
 
-    sem_post(&shared->mutex_exam);
+    seq_leave(shared, &shared->mutex_exam, &ev);
 
     if (q_to_mark == -1) {
-        return 0;   /* nothing left to mark for this exam */
+        return 0;   /* finished, or nothing left to mark for this exam */
     }
 
+    stats_set_state(TA_STATE_MARKING, ev.exam_index, q_to_mark);
+
+    uint64_t t = span_begin();
     random_sleep(1.0, 2.0);
+    span_end(t, SPAN_MARK, q_to_mark, ev.exam_index);
+
+    if (my_stats) {
+        __atomic_fetch_add(&my_stats->questions_marked, 1, __ATOMIC_RELAXED);
+    }
+    stats_set_state(TA_STATE_IDLE, ev.exam_index, -1);
 
-    sem_wait(&shared->mutex_print);
+    lock_wait(&shared->mutex_print, SEM_PRINT);
     printf("[TA %d] Marked exam %04d, question %d\n",
            ta_id, student, q_to_mark + 1);
     fflush(stdout);
@@ -243,6 +667,49 @@ static int mark_one_question(shared_data_t *shared, int ta_id) {
     return 1;
 }
 
+static int send_msg(int fd, const shard_msg_t *msg) {
+    const char *p = (const char *)msg;
+    size_t left = sizeof(*msg);
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n <= 0) return -1;
+        p += n;
+        left -= (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_msg(int fd, shard_msg_t *msg) {
+    char *p = (char *)msg;
+    size_t left = sizeof(*msg);
+    while (left > 0) {
+        ssize_t n = read(fd, p, left);
+        if (n <= 0) return -1;
+        p += n;
+        left -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Ask the coordinator for another exam range once this group's range is
+ * used up. Returns the first exam index of the new range, or -1 when
+ * there is no coordinator or nothing left. Must be called with
+ * mutex_exam HELD – this serialises the TAs' use of shard_fd, and there
+ * is nothing else for them to do until a new exam is loaded anyway.   */
+
+static int request_range(shared_data_t *shared) {
+    if (shard_fd < 0) return -1;
+
+    shard_msg_t msg = { .type = SHARD_MSG_REQUEST };
+    if (send_msg(shard_fd, &msg) < 0 || recv_msg(shard_fd, &msg) < 0 ||
+        msg.type != SHARD_MSG_RANGE || msg.begin >= msg.end) {
+        return -1;
+    }
+
+    shared->range_end = msg.end;
+    return msg.begin;
+}
+
 /* Helper: assumes mutex_exam is already HELD. */
 
 static int all_questions_marked_nolock(const shared_data_t *shared) {
@@ -252,27 +719,35 @@ static int all_questions_marked_nolock(const shared_data_t *shared) {
     return 1;
 }
 
-static void ta_main(shared_data_t *shared, int ta_id) {
-    srand((unsigned int)(time(NULL) ^ (getpid() << 16)));
+static void ta_main(shared_data_t *shared, int ta_id, uint64_t seed) {
+    rng_seed(seed, ta_id);
+    if (timelines) my_timeline = &timelines[ta_id];
+    if (stats) my_stats = &stats->tas[ta_id];
 
     while (1) {
         /* First check if we are finished. */
-        sem_wait(&shared->mutex_exam);
-        if (shared->finished) {
-            sem_post(&shared->mutex_exam);
-            break;
-        }
+        trace_event_t check = { .type = EV_CHECK, .ta_id = (uint8_t)ta_id };
+
+        seq_enter(shared, ta_id, &shared->mutex_exam, SEM_EXAM);
+        int fin = shared->finished;
         int idx = shared->current_exam_index;
         int stu = shared->current_student_id;
-        sem_post(&shared->mutex_exam);
+        check.exam_index = (uint16_t)idx;
+        check.value = (uint8_t)fin;
+        seq_leave(shared, &shared->mutex_exam, &check);
+
+        if (fin) break;
 
-        sem_wait(&shared->mutex_print);
+        lock_wait(&shared->mutex_print, SEM_PRINT);
         printf("[TA %d] Starting work on exam index %d (student %04d)\n",
                ta_id, idx, stu);
         fflush(stdout);
         sem_post(&shared->mutex_print);
 
-        review_rubric(shared, ta_id);
+        uint64_t t = span_begin();
+        review_rubric(shared, ta_id, idx);
+        span_end(t, SPAN_REVIEW, 0, idx);
+        stats_set_state(TA_STATE_IDLE, idx, -1);
 
         /* Mark questions until none available. */
         while (mark_one_question(shared, ta_id)) {
@@ -280,15 +755,32 @@ static void ta_main(shared_data_t *shared, int ta_id) {
         }
 
         /* Attempt to load the next exam – at most one TA succeeds. */
-        sem_wait(&shared->mutex_exam);
+        trace_event_t adv = { .type = EV_ADVANCE, .ta_id = (uint8_t)ta_id };
+
+        seq_enter(shared, ta_id, &shared->mutex_exam, SEM_EXAM);
 
         if (!shared->finished && all_questions_marked_nolock(shared)) {
+            shared->exams_completed++;
+            if (stats) {
+                __atomic_fetch_add(&stats->exams_completed, 1, __ATOMIC_RELAXED);
+            }
+
             int next = shared->current_exam_index + 1;
-            if (next >= shared->total_exams) {
+            if (next >= shared->range_end) {
+                next = request_range(shared);
+            }
+
+            if (next < 0) {
                 shared->finished = 1;
             } else {
-                int next_student = shared->exam_student_ids[next];
+                int next_student = shared->exam_student_ids[exam_slot(shared, next)];
+                stats_set_state(TA_STATE_LOADING, next, -1);
+
+                uint64_t t_load = span_begin();
                 load_exam(shared, next);
+                span_end(t_load, SPAN_LOAD, 0, next);
+
+                stats_set_state(TA_STATE_IDLE, next, -1);
 
                 if (next_student == 9999) {
                     /* last exam logically; finished will be set
@@ -297,20 +789,29 @@ static void ta_main(shared_data_t *shared, int ta_id) {
             }
         }
 
-        /* After exam with student 9999 is fully marked, stop. */
+        /* After exam with student 9999 is fully marked, stop (on the
+         * last pass only – earlier passes wrap back to the start).     */
         if (!shared->finished &&
             shared->current_student_id == 9999 &&
+            shared->current_exam_index == exam_end_index(shared) - 1 &&
             all_questions_marked_nolock(shared)) {
             shared->finished = 1;
         }
 
         int done = shared->finished;
-        sem_post(&shared->mutex_exam);
+        if (stats && done) {
+            __atomic_store_n(&stats->finished, 1, __ATOMIC_RELAXED);
+        }
+        adv.exam_index = (uint16_t)shared->current_exam_index;
+        adv.value = (uint8_t)done;
+        seq_leave(shared, &shared->mutex_exam, &adv);
 
         if (done) break;
     }
 
-    sem_wait(&shared->mutex_print);
+    stats_set_state(TA_STATE_DONE, -1, -1);
+
+    lock_wait(&shared->mutex_print, SEM_PRINT);
     printf("[TA %d] Finishing execution\n", ta_id);
     fflush(stdout);
     sem_post(&shared->mutex_print);
@@ -318,78 +819,899 @@ static void ta_main(shared_data_t *shared, int ta_id) {
     _exit(0);
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        fprintf(stderr,
-                "Usage: %s <num_TAs>=n>=2 <rubric_file> <exam_list_file>\n",
-                argv[0]);
-        return EXIT_FAILURE;
+/* Write the recorded trace (header + events) to path. */
+
+static void write_trace(const char *path, const shared_data_t *shared,
+                        uint64_t seed) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror("fopen trace");
+        exit(EXIT_FAILURE);
     }
 
-    int num_TAs = atoi(argv[1]);
-    const char *rubric_file = argv[2];
-    const char *exam_list_file = argv[3];
+    trace_header_t hdr = {
+        .magic      = TRACE_MAGIC,
+        .version    = TRACE_VERSION,
+        .num_tas    = (uint16_t)shared->num_tas,
+        .seed       = seed,
+        .num_events = shared->trace_count,
+    };
+
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(trace_buf->events, sizeof(trace_event_t),
+               shared->trace_count, f) != shared->trace_count) {
+        perror("fwrite trace");
+        fclose(f);
+        exit(EXIT_FAILURE);
+    }
 
-    if (num_TAs < 2) {
-        fprintf(stderr, "Error: number of TAs (processes) must be >= 2\n");
-        return EXIT_FAILURE;
+    fclose(f);
+
+    if (shared->trace_overflow) {
+        fprintf(stderr, "Warning: trace truncated at %d events\n",
+                MAX_TRACE_EVENTS);
+    }
+}
+
+/* Load a trace for replay; returns the seed it was recorded with. */
+
+static uint64_t read_trace(const char *path, shared_data_t *shared) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror("fopen trace");
+        exit(EXIT_FAILURE);
+    }
+
+    trace_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        hdr.magic != TRACE_MAGIC || hdr.version != TRACE_VERSION) {
+        fprintf(stderr, "%s is not a version %d trace file\n",
+                path, TRACE_VERSION);
+        fclose(f);
+        exit(EXIT_FAILURE);
+    }
+
+    if (hdr.num_tas != shared->num_tas) {
+        fprintf(stderr, "Trace was recorded with %d TAs, not %d\n",
+                hdr.num_tas, shared->num_tas);
+        fclose(f);
+        exit(EXIT_FAILURE);
+    }
+
+    if (hdr.num_events > MAX_TRACE_EVENTS ||
+        fread(trace_buf->events, sizeof(trace_event_t),
+              hdr.num_events, f) != hdr.num_events) {
+        fprintf(stderr, "Trace file %s is truncated or too large\n", path);
+        fclose(f);
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(f);
+
+    shared->trace_count = hdr.num_events;
+    return hdr.seed;
+}
+
+/* Write every TA's spans as Chrome trace-event JSON ("X" complete
+ * events, one thread per TA; slot 0 is the parent).                 */
+
+static void write_timeline(const char *path, const shared_data_t *shared,
+                           int num_TAs) {
+    static const char *sem_names[] = { "mutex_rubric", "mutex_exam", "mutex_print" };
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("fopen timeline");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+               "\"args\":{\"name\":\"TA marking\"}}");
+
+    for (int ta = 0; ta <= num_TAs; ++ta) {
+        const ta_timeline_t *tl = &timelines[ta];
+
+        if (ta == 0) {
+            fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                       "\"tid\":0,\"args\":{\"name\":\"PARENT\"}}");
+        } else {
+            fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                       "\"tid\":%d,\"args\":{\"name\":\"TA %d\"}}", ta, ta);
+        }
+
+        for (unsigned int i = 0; i < tl->count; ++i) {
+            const span_t *sp = &tl->spans[i];
+            int student = shared->exam_student_ids[exam_slot(shared, sp->exam_index)];
+
+            fprintf(f, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                       "\"ts\":%llu,\"dur\":%u,",
+                    ta, (unsigned long long)sp->start_us, sp->dur_us);
+
+            switch (sp->kind) {
+            case SPAN_REVIEW:
+                fprintf(f, "\"name\":\"review rubric\",\"cat\":\"rubric\","
+                           "\"args\":{\"exam\":%d,\"student\":%d}}",
+                        sp->exam_index, student);
+                break;
+            case SPAN_WAIT:
+                fprintf(f, "\"name\":\"wait %s\",\"cat\":\"wait\"}",
+                        sem_names[sp->arg]);
+                break;
+            case SPAN_MARK:
+                fprintf(f, "\"name\":\"mark Q%d\",\"cat\":\"mark\","
+                           "\"args\":{\"exam\":%d,\"student\":%d,\"question\":%d}}",
+                        sp->arg + 1, sp->exam_index, student, sp->arg + 1);
+                break;
+            default:
+                fprintf(f, "\"name\":\"load exam\",\"cat\":\"load\","
+                           "\"args\":{\"exam\":%d,\"student\":%d}}",
+                        sp->exam_index, student);
+                break;
+            }
+        }
+
+        if (tl->dropped) {
+            fprintf(stderr, "Warning: timeline for %s %d dropped %u spans\n",
+                    ta ? "TA" : "PARENT", ta, tl->dropped);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+}
+
+/* Returns 1 if the existing segment called name was left behind by a
+ * run that is no longer alive, 0 if it is in use or not ours to remove. */
+
+static int stats_segment_is_stale(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return errno == ENOENT;   /* vanished meanwhile: retry */
+
+    struct stat sb;
+    if (fstat(fd, &sb) < 0 || (size_t)sb.st_size < sizeof(ta_stats_t)) {
+        close(fd);
+        return 0;
+    }
+
+    const ta_stats_t *old = mmap(NULL, sizeof(ta_stats_t), PROT_READ,
+                                 MAP_SHARED, fd, 0);
+    close(fd);
+    if (old == MAP_FAILED) return 0;
+
+    int stale = __atomic_load_n(&old->magic, __ATOMIC_ACQUIRE) == TA_STATS_MAGIC &&
+                kill(old->pid, 0) < 0 && errno == ESRCH;
+    if (!stale) {
+        fprintf(stderr, "Stats segment %s is in use (pid %d) or not a TA "
+                        "stats segment; pick another --stats name\n",
+                name, old->pid);
+    }
+
+    munmap((void *)old, sizeof(ta_stats_t));
+    return stale;
+}
+
+/* Create the named stats segment (see ta_stats_101231344.h). A segment
+ * of the same name is only replaced if the run that owned it is dead. */
+
+static ta_stats_t *create_stats(const char *name, const shared_data_t *shared,
+                                int num_TAs) {
+    snprintf(stats_name, sizeof(stats_name), "%s%s",
+             name[0] == '/' ? "" : "/", name);
+
+    int fd = shm_open(stats_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        if (!stats_segment_is_stale(stats_name)) exit(EXIT_FAILURE);
+
+        printf("[PARENT] Replacing stale stats segment %s\n", stats_name);
+        fflush(stdout);
+        shm_unlink(stats_name);
+        fd = shm_open(stats_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        perror("shm_open stats");
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+        perror("fstat stats");
+        close(fd);
+        exit(EXIT_FAILURE);
+    }
+    stats_dev = sb.st_dev;
+    stats_ino = sb.st_ino;
+
+    if (ftruncate(fd, sizeof(ta_stats_t)) < 0) {
+        perror("ftruncate stats");
+        close(fd);
+        exit(EXIT_FAILURE);
+    }
+
+    ta_stats_t *st = mmap(NULL, sizeof(ta_stats_t), PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+    close(fd);
+    if (st == MAP_FAILED) {
+        perror("mmap stats");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(st, 0, sizeof(*st));
+    st->version     = TA_STATS_VERSION;
+    st->size        = sizeof(ta_stats_t);
+    st->num_tas     = (uint32_t)num_TAs;
+    st->pid         = (int32_t)getpid();
+    st->total_exams = shared->total_exams;
+    st->end_exam    = exam_end_index(shared);
+    st->start_ns    = now_ns();
+    for (int i = 0; i <= TA_STATS_MAX_TAS; ++i) {
+        st->tas[i].exam_index = -1;
+        st->tas[i].question   = -1;
+    }
+
+    /* Readers only trust the layout once the magic is visible. */
+    __atomic_store_n(&st->magic, TA_STATS_MAGIC, __ATOMIC_RELEASE);
+    return st;
+}
+
+/* Unlink stats_name only if it still names the segment this run created. */
+
+static void remove_stats_name(void) {
+    int fd = shm_open(stats_name, O_RDONLY, 0);
+    if (fd < 0) return;
+
+    struct stat sb;
+    int ours = fstat(fd, &sb) == 0 &&
+               sb.st_dev == stats_dev && sb.st_ino == stats_ino;
+    close(fd);
+
+    if (ours) shm_unlink(stats_name);
+}
+
+/* Parse a sysfs cpulist such as "0-3,8-11" into set. */
+
+static void parse_cpulist(const char *list, cpu_set_t *set) {
+    CPU_ZERO(set);
+
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p) break;
+
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+        }
+        for (long c = lo; c <= hi && c < CPU_SETSIZE; ++c) {
+            CPU_SET((int)c, set);
+        }
+
+        p = (*end == ',') ? end + 1 : end;
+        if (*p == '\n') break;
+    }
+}
+
+/* Find the NUMA nodes that have CPUs we are allowed to run on. Without
+ * /sys/devices/system/node, everything is treated as one node.        */
+
+static void discover_numa_nodes(void) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        perror("sched_getaffinity");
+        exit(EXIT_FAILURE);
+    }
+
+    num_numa_nodes = 0;
+    for (int id = 0; id < MAX_NUMA_NODES; ++id) {
+        char path[64];
+        char line[1024];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        if (!fgets(line, sizeof(line), f)) line[0] = '\0';
+        fclose(f);
+
+        numa_node_t *node = &numa_nodes[num_numa_nodes];
+        parse_cpulist(line, &node->cpus);
+        CPU_AND(&node->cpus, &node->cpus, &allowed);
+        if (CPU_COUNT(&node->cpus) == 0) continue;   /* memory-only node */
+
+        node->id = id;
+        num_numa_nodes++;
+    }
+
+    if (num_numa_nodes == 0) {
+        numa_nodes[0].id = -1;
+        numa_nodes[0].cpus = allowed;
+        num_numa_nodes = 1;
+    }
+}
+
+/* Restrict the calling process to the nth CPU of set (round robin). */
+
+static void pin_to_cpu(const cpu_set_t *set, int n) {
+    int count = CPU_COUNT(set);
+    if (count == 0) return;
+
+    int want = n % count;
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, set) && want-- == 0) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(c, &one);
+            if (sched_setaffinity(0, sizeof(one), &one) < 0) {
+                perror("sched_setaffinity");
+            }
+            return;
+        }
+    }
+}
+
+/* Prefer node-local pages for [addr, addr + len). Must run before the
+ * memory is first touched. If mbind is unavailable the CPU affinity set
+ * by the caller still gives node-local first-touch placement.         */
+
+static void bind_to_node(void *addr, size_t len, int node_id) {
+    if (node_id < 0) return;
+
+#ifdef SYS_mbind
+    unsigned long mask[MAX_NUMA_NODES / (8 * sizeof(unsigned long)) + 1] = { 0 };
+    mask[node_id / (8 * sizeof(unsigned long))] |=
+        1ul << (node_id % (8 * sizeof(unsigned long)));
+
+    if (syscall(SYS_mbind, addr, len, TA_MPOL_PREFERRED, mask,
+                (unsigned long)MAX_NUMA_NODES + 1, 0) != 0) {
+        fprintf(stderr, "mbind to node %d failed (%s); relying on "
+                        "first-touch placement\n", node_id, strerror(errno));
+    }
+#else
+    (void)addr;
+    (void)len;
+#endif
+}
+
+/* Initialise semaphores (pshared = 1 so they are shared between processes). */
+
+static void init_semaphores(shared_data_t *shared) {
+    if (sem_init(&shared->mutex_rubric, 1, 1) == -1 ||
+        sem_init(&shared->mutex_exam,   1, 1) == -1 ||
+        sem_init(&shared->mutex_print,  1, 1) == -1 ||
+        sem_init(&shared->mutex_trace,  1, 1) == -1) {
+        perror("sem_init");
+        exit(EXIT_FAILURE);
     }
+}
 
+static void destroy_semaphores(shared_data_t *shared) {
+    sem_destroy(&shared->mutex_rubric);
+    sem_destroy(&shared->mutex_exam);
+    sem_destroy(&shared->mutex_print);
+    sem_destroy(&shared->mutex_trace);
+}
+
+/* Create the record/replay segment (only for --record / --replay). */
+
+static void create_trace_buf(void) {
+    trace_shm_id = shmget(IPC_PRIVATE, sizeof(trace_buf_t), IPC_CREAT | 0666);
+    if (trace_shm_id < 0) {
+        perror("shmget trace");
+        exit(EXIT_FAILURE);
+    }
+
+    trace_buf = (trace_buf_t *)shmat(trace_shm_id, NULL, 0);
+    if (trace_buf == (void *)-1) {
+        perror("shmat trace");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i <= MAX_TAS; ++i) {
+        if (sem_init(&trace_buf->ta_turn[i], 1, 0) == -1) {
+            perror("sem_init");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void destroy_trace_buf(void) {
+    for (int i = 0; i <= MAX_TAS; ++i) {
+        sem_destroy(&trace_buf->ta_turn[i]);
+    }
+
+    shmdt(trace_buf);
+    shmctl(trace_shm_id, IPC_RMID, NULL);
+    trace_buf = NULL;
+}
+
+/* Create and zero the group's segment; node_id >= 0 binds it to that
+ * NUMA node first.                                                     */
+
+static shared_data_t *create_shared(int node_id) {
     shm_id = shmget(IPC_PRIVATE, sizeof(shared_data_t),
                     IPC_CREAT | 0666);
     if (shm_id < 0) {
         perror("shmget");
-        return EXIT_FAILURE;
+        exit(EXIT_FAILURE);
     }
 
     shared_data_t *shared =
         (shared_data_t *)shmat(shm_id, NULL, 0);
     if (shared == (void *)-1) {
         perror("shmat");
-        return EXIT_FAILURE;
+        exit(EXIT_FAILURE);
     }
 
+    bind_to_node(shared, sizeof(*shared), node_id);
     memset(shared, 0, sizeof(*shared));
+    return shared;
+}
 
-    load_rubric(rubric_file, shared);
-    load_exam_list(exam_list_file, shared);
+/* Fork num_TAs TA processes (ids first_id, first_id + 1, ...) and wait
+ * for all of them to finish. With --pin, TA i takes CPU place + i of
+ * group_cpus, so groups sharing a CPU set must pass disjoint places.  */
 
-    /* Initialise semaphores (pshared = 1 so they are shared between processes). */
-  
-    if (sem_init(&shared->mutex_rubric, 1, 1) == -1 ||
-        sem_init(&shared->mutex_exam,   1, 1) == -1 ||
-        sem_init(&shared->mutex_print,  1, 1) == -1) {
-        perror("sem_init");
-        return EXIT_FAILURE;
+static void run_tas(shared_data_t *shared, int first_id, int num_TAs,
+                    uint64_t seed, int place) {
+    for (int i = 0; i < num_TAs; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            if (pin_tas) pin_to_cpu(&group_cpus, place + i);
+            ta_main(shared, first_id + i, seed);
+        }
+    }
+
+    /* Parent waits for children. */
+    for (int i = 0; i < num_TAs; ++i) {
+        wait(NULL);
+    }
+}
+
+/* One shard of --shards mode: an ordinary TA group with its own shared
+ * segment and semaphores, fed exam ranges by the coordinator over fd.
+ * TA ids are numbered globally so the output stays unambiguous.       */
+
+static void shard_main(const shared_data_t *tmpl, int shard, int fd,
+                       int num_TAs, uint64_t seed) {
+    uint64_t start = now_ns();
+
+    shard_fd = fd;
+
+    /* Move onto the shard's node before creating (and first touching)
+     * its segment, so the segment and all of its TAs stay node-local. */
+    int node_id = -1;
+    int place = shard * num_TAs;
+    if (use_numa) {
+        const numa_node_t *node = &numa_nodes[shard % num_numa_nodes];
+        node_id = node->id;
+        group_cpus = node->cpus;
+        place = (shard / num_numa_nodes) * num_TAs;   /* rank among this node's shards */
+        if (sched_setaffinity(0, sizeof(group_cpus), &group_cpus) < 0) {
+            perror("sched_setaffinity");
+        }
     }
 
+    shared_data_t *shared = create_shared(node_id);
+    memcpy(shared, tmpl, sizeof(*shared));
+    shared->num_tas = num_TAs;
+    init_semaphores(shared);
+
     sem_wait(&shared->mutex_exam);
-    shared->finished = 0;
-    shared->current_exam_index = 0;
-    load_exam(shared, 0);
+    int first = request_range(shared);
+    if (first >= 0) {
+        load_exam(shared, first);
+    } else {
+        shared->finished = 1;
+    }
     sem_post(&shared->mutex_exam);
 
-    /* Fork TA processes. */
-    for (int i = 0; i < num_TAs; ++i) {
+    if (first >= 0) {
+        run_tas(shared, shard * num_TAs + 1, num_TAs, seed, place);
+    }
+
+    shard_msg_t done = {
+        .type               = SHARD_MSG_DONE,
+        .exams_completed    = shared->exams_completed,
+        .questions_marked   = shared->questions_marked,
+        .rubric_corrections = shared->rubric_corrections,
+        .elapsed_ns         = (int64_t)(now_ns() - start),
+    };
+    send_msg(fd, &done);
+    close(fd);
+
+    destroy_semaphores(shared);
+    shmdt(shared);
+    shmctl(shm_id, IPC_RMID, NULL);
+
+    _exit(0);
+}
+
+/* Unstarted exams still held by the coordinator for one shard. */
+typedef struct {
+    int lo;
+    int hi;
+} shard_queue_t;
+
+/* Hand shard s its next chunk [*begin, *end). When its own queue is
+ * empty, steal the back half of the largest remaining queue – i.e. the
+ * unstarted work of the slowest group. Returns 0 when nothing is left. */
+
+static int take_range(shard_queue_t *queues, int num_shards, int s, int chunk,
+                      int *begin, int *end, int *steals) {
+    shard_queue_t *q = &queues[s];
+
+    if (q->lo >= q->hi) {
+        int victim = -1;
+        for (int v = 0; v < num_shards; ++v) {
+            int left = queues[v].hi - queues[v].lo;
+            if (v != s && left > 0 &&
+                (victim < 0 || left > queues[victim].hi - queues[victim].lo)) {
+                victim = v;
+            }
+        }
+        if (victim < 0) return 0;
+
+        int left = queues[victim].hi - queues[victim].lo;
+        int take = (left + 1) / 2;
+        q->hi = queues[victim].hi;
+        q->lo = q->hi - take;
+        queues[victim].hi = q->lo;
+        (*steals)++;
+
+        printf("[COORD] Shard %d stole exams %d..%d from shard %d\n",
+               s, q->lo, q->hi - 1, victim);
+        fflush(stdout);
+    }
+
+    *begin = q->lo;
+    *end   = (q->hi - q->lo > chunk) ? q->lo + chunk : q->hi;
+    q->lo  = *end;
+    return 1;
+}
+
+/* --shards mode: partition the exam list, launch one TA group per shard,
+ * serve range requests until every group reports back, then print the
+ * merged results.                                                      */
+
+static int run_coordinator(const char *rubric_file, const char *exam_list_file,
+                           int num_shards, int num_TAs, int passes,
+                           uint64_t seed) {
+    shared_data_t *tmpl = calloc(1, sizeof(*tmpl));
+    if (!tmpl) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    load_rubric(rubric_file, tmpl);
+    load_exam_list(exam_list_file, tmpl);
+    set_passes(tmpl, passes);
+
+    /* Exams after the 9999 terminator are never marked, so never hand them out. */
+    int limit = exam_end_index(tmpl);
+
+    if (num_shards > limit) num_shards = limit;
+
+    shard_queue_t queues[MAX_SHARDS];
+    shard_msg_t   results[MAX_SHARDS];
+    int           fds[MAX_SHARDS];
+    int           steals = 0;
+
+    int per_shard = limit / num_shards;
+    int chunk = per_shard / 4 > 0 ? per_shard / 4 : 1;
+
+    for (int s = 0; s < num_shards; ++s) {
+        queues[s].lo = s * per_shard;
+        queues[s].hi = (s == num_shards - 1) ? limit : (s + 1) * per_shard;
+        memset(&results[s], 0, sizeof(results[s]));
+    }
+
+    printf("[COORD] %d exams across %d shards of %d TAs (chunk %d)\n",
+           limit, num_shards, num_TAs, chunk);
+    if (use_numa) {
+        for (int s = 0; s < num_shards; ++s) {
+            const numa_node_t *node = &numa_nodes[s % num_numa_nodes];
+            printf("[COORD] Shard %d on NUMA node %d (%d CPUs)%s\n",
+                   s, node->id, CPU_COUNT(&node->cpus),
+                   pin_tas ? ", TAs pinned" : "");
+        }
+    }
+    fflush(stdout);
+
+    for (int s = 0; s < num_shards; ++s) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            perror("socketpair");
+            return EXIT_FAILURE;
+        }
+
         pid_t pid = fork();
         if (pid < 0) {
             perror("fork");
             return EXIT_FAILURE;
         }
         if (pid == 0) {
-            ta_main(shared, i + 1);
+            for (int j = 0; j < s; ++j) close(fds[j]);
+            close(sv[0]);
+            shard_main(tmpl, s, sv[1], num_TAs, seed);
         }
+
+        close(sv[1]);
+        fds[s] = sv[0];
     }
 
-    /* Parent waits for children. */
-    for (int i = 0; i < num_TAs; ++i) {
+    struct pollfd pfds[MAX_SHARDS];
+    int live = num_shards;
+    for (int s = 0; s < num_shards; ++s) {
+        pfds[s].fd = fds[s];
+        pfds[s].events = POLLIN;
+    }
+
+    while (live > 0) {
+        if (poll(pfds, (nfds_t)num_shards, -1) < 0) {
+            perror("poll");
+            return EXIT_FAILURE;
+        }
+
+        for (int s = 0; s < num_shards; ++s) {
+            if (pfds[s].fd < 0 || !(pfds[s].revents & (POLLIN | POLLHUP))) continue;
+
+            shard_msg_t msg = { 0 };
+            if (recv_msg(fds[s], &msg) < 0 || msg.type == SHARD_MSG_DONE) {
+                if (msg.type == SHARD_MSG_DONE) {
+                    results[s] = msg;
+                } else {
+                    fprintf(stderr, "[COORD] Shard %d exited without reporting\n", s);
+                }
+                close(fds[s]);
+                pfds[s].fd = -1;
+                live--;
+                continue;
+            }
+
+            shard_msg_t reply = { .type = SHARD_MSG_RANGE };
+            if (msg.type == SHARD_MSG_REQUEST &&
+                take_range(queues, num_shards, s, chunk,
+                           &reply.begin, &reply.end, &steals)) {
+                printf("[COORD] Shard %d takes exams %d..%d\n",
+                       s, reply.begin, reply.end - 1);
+                fflush(stdout);
+            }
+            send_msg(fds[s], &reply);
+        }
+    }
+
+    for (int s = 0; s < num_shards; ++s) {
         wait(NULL);
     }
 
+    /* Merge the per-shard results. */
+    shard_msg_t total = { 0 };
+    printf("[COORD] shard  exams  questions  rubric fixes  elapsed\n");
+    for (int s = 0; s < num_shards; ++s) {
+        printf("[COORD] %5d  %5d  %9d  %12d  %8.4fs\n", s,
+               results[s].exams_completed, results[s].questions_marked,
+               results[s].rubric_corrections, results[s].elapsed_ns / 1e9);
+        total.exams_completed    += results[s].exams_completed;
+        total.questions_marked   += results[s].questions_marked;
+        total.rubric_corrections += results[s].rubric_corrections;
+        if (results[s].elapsed_ns > total.elapsed_ns) {
+            total.elapsed_ns = results[s].elapsed_ns;
+        }
+    }
+    printf("[COORD] total  %5d  %9d  %12d  %8.4fs  (%d steals, %.3f exams/s)\n",
+           total.exams_completed, total.questions_marked,
+           total.rubric_corrections, total.elapsed_ns / 1e9, steals,
+           total.elapsed_ns > 0 ? total.exams_completed / (total.elapsed_ns / 1e9) : 0.0);
+    fflush(stdout);
+
+    free(tmpl);
+    return total.exams_completed == limit ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s <num_TAs>=n>=2 <rubric_file> <exam_list_file>\n"
+            "          [--seed <n>] [--record <file> | --replay <file>]\n"
+            "          [--timeline <file>] [--stats <name>] [--shards <k>]\n"
+            "          [--pin] [--numa] [--sleep-scale <f>] [--passes <n>]\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int num_TAs = atoi(argv[1]);
+    const char *rubric_file = argv[2];
+    const char *exam_list_file = argv[3];
+
+    uint64_t seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 16);
+    const char *record_file = NULL;
+    const char *replay_file = NULL;
+    const char *timeline_file = NULL;
+    const char *stats_file = NULL;
+    int num_shards = 0;
+    int shards_given = 0;    /* any explicit --shards value, even < 1 */
+    int passes = 1;
+
+    for (int i = 4; i < argc; ++i) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_file = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (strcmp(argv[i], "--timeline") == 0 && i + 1 < argc) {
+            timeline_file = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_file = argv[++i];
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            num_shards = atoi(argv[++i]);
+            shards_given = 1;
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            pin_tas = 1;
+        } else if (strcmp(argv[i], "--numa") == 0) {
+            use_numa = 1;
+        } else if (strcmp(argv[i], "--sleep-scale") == 0 && i + 1 < argc) {
+            sleep_scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+            passes = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (num_TAs < 2) {
+        fprintf(stderr, "Error: number of TAs (processes) must be >= 2\n");
+        return EXIT_FAILURE;
+    }
+
+    if (num_TAs > MAX_TAS) {
+        fprintf(stderr, "Error: at most %d TAs are supported\n", MAX_TAS);
+        return EXIT_FAILURE;
+    }
+
+    if (record_file && replay_file) {
+        fprintf(stderr, "Error: --record and --replay are exclusive\n");
+        return EXIT_FAILURE;
+    }
+
+    discover_numa_nodes();
+    if (sched_getaffinity(0, sizeof(group_cpus), &group_cpus) < 0) {
+        perror("sched_getaffinity");
+        return EXIT_FAILURE;
+    }
+
+    /* One exam queue (shard) per node unless told otherwise. */
+    if (use_numa && !shards_given) {
+        num_shards = num_numa_nodes;
+        shards_given = 1;
+    }
+
+    if (shards_given) {
+        if (num_shards < 1 || num_shards > MAX_SHARDS) {
+            fprintf(stderr, "Error: --shards must be between 1 and %d\n",
+                    MAX_SHARDS);
+            return EXIT_FAILURE;
+        }
+        if (record_file || replay_file || timeline_file || stats_file) {
+            fprintf(stderr, "Error: --shards cannot be combined with "
+                            "--record, --replay, --timeline or --stats\n");
+            return EXIT_FAILURE;
+        }
+        return run_coordinator(rubric_file, exam_list_file,
+                               num_shards, num_TAs, passes, seed);
+    }
+
+    shared_data_t *shared = create_shared(-1);
+
+    if (pin_tas) {
+        printf("[PARENT] Pinning %d TAs across %d CPUs\n",
+               num_TAs, CPU_COUNT(&group_cpus));
+        fflush(stdout);
+    }
+
+    load_rubric(rubric_file, shared);
+    load_exam_list(exam_list_file, shared);
+    set_passes(shared, passes);
+    shared->range_end = exam_end_index(shared);   /* stop at the 9999 terminator */
+
+    shared->num_tas = num_TAs;
+    if (record_file || replay_file) {
+        create_trace_buf();
+    }
+
+    if (record_file) {
+        shared->trace_mode = TRACE_RECORD;
+        printf("[PARENT] Recording schedule to %s (seed %llu)\n",
+               record_file, (unsigned long long)seed);
+        fflush(stdout);
+    } else if (replay_file) {
+        seed = read_trace(replay_file, shared);
+        shared->trace_mode = TRACE_REPLAY;
+        shared->replay_active = shared->trace_count > 0;
+        printf("[PARENT] Replaying %u events from %s (seed %llu)\n",
+               shared->trace_count, replay_file, (unsigned long long)seed);
+        fflush(stdout);
+    }
+
+    if (stats_file) {
+        stats = create_stats(stats_file, shared, num_TAs);
+        printf("[PARENT] Publishing live stats in %s\n", stats_name);
+        fflush(stdout);
+    }
+
+    /* Timeline buffers live in their own segment, one slot per TA plus
+     * slot 0 for the parent, and are only created when requested.     */
+    if (timeline_file) {
+        timeline_shm_id = shmget(IPC_PRIVATE,
+                                 sizeof(ta_timeline_t) * (size_t)(num_TAs + 1),
+                                 IPC_CREAT | 0666);
+        if (timeline_shm_id < 0) {
+            perror("shmget timeline");
+            return EXIT_FAILURE;
+        }
+
+        timelines = (ta_timeline_t *)shmat(timeline_shm_id, NULL, 0);
+        if (timelines == (void *)-1) {
+            perror("shmat timeline");
+            return EXIT_FAILURE;
+        }
+
+        memset(timelines, 0, sizeof(ta_timeline_t) * (size_t)(num_TAs + 1));
+        timeline_t0_us = now_us();
+        my_timeline = &timelines[0];
+    }
+
+    init_semaphores(shared);
+
+    sem_wait(&shared->mutex_exam);
+    shared->finished = 0;
+    shared->current_exam_index = 0;
+    uint64_t t_load = span_begin();
+    load_exam(shared, 0);
+    span_end(t_load, SPAN_LOAD, 0, 0);
+    sem_post(&shared->mutex_exam);
+
+    /* Fork TA processes. */
+    run_tas(shared, 1, num_TAs, seed, 0);
+
+    if (record_file) {
+        write_trace(record_file, shared, seed);
+        printf("[PARENT] Wrote %u events to %s\n",
+               shared->trace_count, record_file);
+        fflush(stdout);
+    }
+
+    if (timeline_file) {
+        write_timeline(timeline_file, shared, num_TAs);
+        printf("[PARENT] Wrote timeline to %s\n", timeline_file);
+        fflush(stdout);
+
+        shmdt(timelines);
+        shmctl(timeline_shm_id, IPC_RMID, NULL);
+    }
+
+    if (stats) {
+        /* Monitors that are already attached keep their mapping. */
+        __atomic_store_n(&stats->finished, 1, __ATOMIC_RELAXED);
+        munmap(stats, sizeof(ta_stats_t));
+        remove_stats_name();
+    }
+
     /* Clean up. */
-    sem_destroy(&shared->mutex_rubric);
-    sem_destroy(&shared->mutex_exam);
-    sem_destroy(&shared->mutex_print);
+    if (trace_buf) {
+        destroy_trace_buf();
+    }
+    destroy_semaphores(shared);
 
     shmdt(shared);
     shmctl(shm_id, IPC_RMID, NULL);
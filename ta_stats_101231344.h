@@ -0,0 +1,73 @@
+/*
+ * SYSC4001 – Assignment 3 – Part 2(b)
+ * Student: 101231344
+ *
+ * Layout of the live statistics segment shared between
+ * part2b_101231344 (writer, --stats <name>) and tamon (read-only).
+ *
+ * The segment is created with shm_open(<name>). The simulation fills in
+ * every field and stores magic LAST, so a reader that sees TA_STATS_MAGIC
+ * sees a fully initialised header. All counters are updated with relaxed
+ * atomics by the TAs themselves; readers never take any lock, so
+ * attaching a monitor does not slow the run down.
+ *
+ * Bump TA_STATS_VERSION whenever the layout below changes.
+ */
+
+#ifndef TA_STATS_101231344_H
+#define TA_STATS_101231344_H
+
+#include <stdint.h>
+
+#define TA_STATS_MAGIC     0x53544154u   /* "TATS" */
+#define TA_STATS_VERSION   2
+#define TA_STATS_MAX_TAS   64
+#define TA_STATS_NUM_LOCKS 3              /* mutex_rubric, mutex_exam, mutex_print */
+
+enum {
+    TA_STATE_IDLE = 0,
+    TA_STATE_REVIEWING,
+    TA_STATE_WAITING,
+    TA_STATE_MARKING,
+    TA_STATE_LOADING,
+    TA_STATE_DONE
+};
+
+typedef struct {
+    uint64_t acquisitions;
+    uint64_t contended;        /* acquisitions that had to block      */
+    uint64_t wait_ns;          /* total time spent blocked            */
+} ta_lock_stats_t;
+
+typedef struct {
+    uint32_t state;            /* TA_STATE_*                          */
+    uint32_t waiting_on;       /* lock index while TA_STATE_WAITING   */
+    int32_t  exam_index;       /* exam the TA is working on           */
+    int32_t  question;         /* 0-based question while marking, -1 otherwise */
+    uint64_t questions_marked;
+    uint64_t rubric_corrections;
+} ta_stats_ta_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;             /* sizeof(ta_stats_t)                  */
+    uint32_t num_tas;
+    int32_t  pid;              /* parent process of the simulation    */
+    int32_t  total_exams;
+    int32_t  end_exam;         /* one past the 9999 terminator's index */
+    int32_t  reserved;
+
+    int32_t  current_exam_index;
+    int32_t  current_student_id;
+    uint32_t questions_remaining;   /* unclaimed questions on the current exam */
+    uint32_t exams_completed;
+    uint32_t finished;
+
+    uint64_t start_ns;         /* CLOCK_MONOTONIC at start of run     */
+
+    ta_lock_stats_t locks[TA_STATS_NUM_LOCKS];
+    ta_stats_ta_t   tas[TA_STATS_MAX_TAS + 1];   /* indexed by TA id, 0 unused */
+} ta_stats_t;
+
+#endif /* TA_STATS_101231344_H */
@@ -0,0 +1,201 @@
+/*
+ * SYSC4001 – Assignment 3 – Part 2(b)
+ * Student: 101231344
+ *
+ * tamon – live, read-only monitor for a running part2b_101231344.
+ *
+ * Usage:
+ *   ./tamon <stats_name> [interval_ms]
+ *
+ *   <stats_name>  : name passed to part2b_101231344 --stats
+ *   [interval_ms] : refresh period (default 500); 0 prints once and exits
+ *
+ * The stats segment is mapped PROT_READ and never locked, so attaching
+ * and detaching has no effect on the TAs. Exits once the simulation
+ * reports it has finished or its parent process is gone.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ta_stats_101231344.h"
+
+static const char *state_names[] = {
+    "idle", "reviewing", "waiting", "marking", "loading", "done"
+};
+
+static const char *lock_names[TA_STATS_NUM_LOCKS] = {
+    "mutex_rubric", "mutex_exam", "mutex_print"
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#define LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+static const ta_stats_t *attach(const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        perror("shm_open");
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) < 0 || (size_t)sb.st_size < sizeof(ta_stats_t)) {
+        fprintf(stderr, "%s is not a TA stats segment\n", path);
+        close(fd);
+        exit(EXIT_FAILURE);
+    }
+
+    const ta_stats_t *st = mmap(NULL, sizeof(ta_stats_t), PROT_READ,
+                                MAP_SHARED, fd, 0);
+    close(fd);
+    if (st == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+
+    /* The simulation stores the magic last; give a just-started run a
+     * moment to finish filling in the header.                         */
+    for (int tries = 0; tries < 20; ++tries) {
+        if (__atomic_load_n(&st->magic, __ATOMIC_ACQUIRE) != 0) break;
+        usleep(100000);
+    }
+
+    uint32_t magic = __atomic_load_n(&st->magic, __ATOMIC_ACQUIRE);
+    if (magic == 0) {
+        fprintf(stderr, "%s: segment not initialised yet\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    if (magic != TA_STATS_MAGIC ||
+        st->version != TA_STATS_VERSION ||
+        st->size != sizeof(ta_stats_t)) {
+        fprintf(stderr, "%s: unsupported stats layout (version %u, need %d)\n",
+                path, st->version, TA_STATS_VERSION);
+        exit(EXIT_FAILURE);
+    }
+
+    return st;
+}
+
+/* Print one snapshot. prev_* carry the previous sample for the rate. */
+static void show(const ta_stats_t *st, const char *name,
+                 uint64_t *prev_ns, uint32_t *prev_done, int clear) {
+    uint64_t now      = now_ns();
+    double   elapsed  = (double)(now - st->start_ns) / 1e9;
+    uint32_t done     = LOAD(st->exams_completed);
+    int32_t  cur      = LOAD(st->current_exam_index);
+    uint32_t q_left   = LOAD(st->questions_remaining);
+    int      exams_left = st->end_exam - cur - 1;
+
+    double rate_total = elapsed > 0.0 ? done / elapsed : 0.0;
+    double rate_now   = rate_total;
+    if (*prev_ns && now > *prev_ns) {
+        rate_now = (double)(done - *prev_done) / ((double)(now - *prev_ns) / 1e9);
+    }
+    *prev_ns   = now;
+    *prev_done = done;
+
+    if (clear) printf("\033[H\033[2J");
+
+    printf("tamon: %s (pid %d)  elapsed %.1fs%s\n",
+           name, st->pid, elapsed, LOAD(st->finished) ? "  [finished]" : "");
+    printf("exam %d/%d (student %04d)  completed %u  "
+           "%.3f exams/s (now %.3f)\n",
+           cur + 1, st->end_exam, LOAD(st->current_student_id),
+           done, rate_total, rate_now);
+    printf("queue: %u question(s) left on current exam, %d exam(s) pending\n\n",
+           q_left, exams_left > 0 ? exams_left : 0);
+
+    printf("%-5s %-17s %-6s %-9s %-8s %s\n",
+           "TA", "state", "exam", "question", "marked", "rubric fixes");
+    for (uint32_t i = 1; i <= st->num_tas && i <= TA_STATS_MAX_TAS; ++i) {
+        const ta_stats_ta_t *ta = &st->tas[i];
+        uint32_t state = LOAD(ta->state);
+        int32_t  exam  = LOAD(ta->exam_index);
+        int32_t  q     = LOAD(ta->question);
+        char     state_buf[32];
+
+        if (state == TA_STATE_WAITING) {
+            uint32_t lock = LOAD(ta->waiting_on);
+            snprintf(state_buf, sizeof(state_buf), "wait:%s",
+                     lock < TA_STATS_NUM_LOCKS ? lock_names[lock] : "?");
+        } else {
+            snprintf(state_buf, sizeof(state_buf), "%s",
+                     state <= TA_STATE_DONE ? state_names[state] : "?");
+        }
+
+        printf("%-5u %-17s ", i, state_buf);
+        if (exam >= 0) printf("%-6d ", exam); else printf("%-6s ", "-");
+        if (q >= 0)    printf("Q%-8d ", q + 1); else printf("%-9s ", "-");
+        printf("%-8llu %llu\n",
+               (unsigned long long)LOAD(ta->questions_marked),
+               (unsigned long long)LOAD(ta->rubric_corrections));
+    }
+
+    printf("\n%-13s %-10s %-10s %-8s %s\n",
+           "lock", "acquired", "contended", "ratio", "avg wait");
+    for (int l = 0; l < TA_STATS_NUM_LOCKS; ++l) {
+        uint64_t acq  = LOAD(st->locks[l].acquisitions);
+        uint64_t cont = LOAD(st->locks[l].contended);
+        uint64_t wait = LOAD(st->locks[l].wait_ns);
+
+        printf("%-13s %-10llu %-10llu %6.1f%%  %.3f ms\n",
+               lock_names[l], (unsigned long long)acq, (unsigned long long)cont,
+               acq ? 100.0 * (double)cont / (double)acq : 0.0,
+               cont ? (double)wait / (double)cont / 1e6 : 0.0);
+    }
+
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <stats_name> [interval_ms]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *name = argv[1];
+    int interval_ms = (argc == 3) ? atoi(argv[2]) : 500;
+
+    const ta_stats_t *st = attach(name);
+    uint64_t prev_ns = 0;
+    uint32_t prev_done = 0;
+
+    if (interval_ms <= 0) {
+        show(st, name, &prev_ns, &prev_done, 0);
+        return EXIT_SUCCESS;
+    }
+
+    while (1) {
+        show(st, name, &prev_ns, &prev_done, 1);
+
+        if (LOAD(st->finished)) break;
+        if (kill(st->pid, 0) < 0 && errno == ESRCH) {
+            printf("\nSimulation process %d has exited\n", st->pid);
+            break;
+        }
+
+        usleep((useconds_t)interval_ms * 1000u);
+    }
+
+    return EXIT_SUCCESS;
+}